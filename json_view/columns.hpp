@@ -0,0 +1,428 @@
+#ifndef JV_COLUMNS_HPP
+#define JV_COLUMNS_HPP
+#pragma once
+
+#include "json_view.hpp"
+#include "hash.hpp"
+#include "msgpack.hpp"
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+namespace mjv
+{
+
+// One field of an array of records, stored contiguously.
+// Type is one of t_null (no values at all), t_bool, t_int, t_num, t_string, t_binary
+struct Column {
+    std::string_view name;
+    Types type = t_null;
+    // bit (row % 8) of byte (row / 8) is set if field is null or missing in that row
+    uint8_t* nulls = nullptr;
+    union {
+        bool* bools;
+        int64_t* ints;
+        double* nums;
+        // t_string, t_binary: row is [offsets[row], offsets[row + 1]) of data
+        uint32_t* offsets = nullptr;
+    };
+    char* data = nullptr;
+
+    constexpr bool IsNull(unsigned row) const noexcept {
+        return nulls[row / 8] & (1u << (row % 8));
+    }
+    constexpr std::string_view StringAt(unsigned row) const noexcept {
+        assert(type == t_string || type == t_binary);
+        return {data + offsets[row], offsets[row + 1] - offsets[row]};
+    }
+    constexpr JsonView operator[](unsigned row) const noexcept {
+        if (IsNull(row)) {
+            return nullptr;
+        }
+        switch (type) {
+        case t_bool: return bools[row];
+        case t_int: return ints[row];
+        case t_num: return nums[row];
+        case t_string: return StringAt(row);
+        case t_binary: return JsonView::Binary(StringAt(row));
+        default: return nullptr;
+        }
+    }
+};
+
+// Struct-of-arrays form of an array of maps. Columns are sorted by name.
+struct Columns {
+    Column* columns = nullptr;
+    unsigned count = 0;
+    unsigned rows = 0;
+    std::string_view error = {};
+
+    constexpr bool Valid() const noexcept {
+        return error.empty();
+    }
+    constexpr const Column* begin() const noexcept {
+        return columns;
+    }
+    constexpr const Column* end() const noexcept {
+        return columns + count;
+    }
+    // nullptr if there is no such column
+    constexpr const Column* operator[](std::string_view name) const noexcept {
+        auto it = std::lower_bound(begin(), end(), name, [](const Column& c, std::string_view n){
+            return c.name < n;
+        });
+        return it != end() && it->name == name ? it : nullptr;
+    }
+};
+
+// Infer schema of an array of maps with string keys and copy it into columns.
+// Integers become t_int unless some do not fit into int64_t, mixed ints and floats become t_num.
+// Any other mix of types in one field, nested arrays/maps or duplicate keys are errors.
+// All memory comes from 'alloc' (same as for msgpack::Parse())
+template<msgpack::alloc Alloc>
+Columns ToColumns(JsonView records, Alloc&& alloc) noexcept;
+
+namespace msgpack
+{
+
+// Same as ToColumns(Parse(buffer)), but only one record is parsed at a time
+template<int flags = Default, alloc Alloc>
+Columns ParseColumns(std::string_view buffer, Alloc&& alloc, unsigned depthLimit = 30) noexcept;
+
+// Writes an array of maps with every column present in every row (missing fields become nil)
+template<int flags = Default, writer Writer>
+constexpr auto Dump(Columns const& cols, Writer&& out) noexcept;
+
+} //msgpack
+
+namespace detail {
+
+struct ColumnInfo {
+    std::string_view name;
+    unsigned types = 0;
+    bool bigUint = false;
+    size_t bytes = 0;
+};
+
+template<typename T, typename Alloc>
+[[gnu::always_inline]]
+inline T* allocArray(Alloc& alloc, size_t count) noexcept {
+    return (T*)alloc(sizeof(T) * (count ? count : 1));
+}
+
+// Records of the same shape hit 'hint' (index found for this position in previous record)
+template<typename T>
+inline unsigned findColumn(const T* cols, unsigned count, std::string_view name, unsigned& hint) noexcept {
+    if (hint < count && cols[hint].name == name) [[likely]] {
+        return hint;
+    }
+    auto it = std::lower_bound(cols, cols + count, name, [](const T& c, std::string_view n){
+        return c.name < n;
+    });
+    return hint = unsigned(it - cols);
+}
+
+inline constexpr unsigned typeBit(Types t) noexcept {
+    return 1u << t;
+}
+
+inline constexpr Types resolveColumn(ColumnInfo const& info) noexcept {
+    constexpr auto ints = typeBit(t_int) | typeBit(t_uint);
+    auto types = info.types & ~typeBit(t_null);
+    if (!types) {
+        return t_null;
+    } else if (types == typeBit(t_bool)) {
+        return t_bool;
+    } else if (!(types & ~ints)) {
+        return info.bigUint ? t_num : t_int;
+    } else if (!(types & ~(ints | typeBit(t_num)))) {
+        return t_num;
+    } else if (types == typeBit(t_string)) {
+        return t_string;
+    } else if (types == typeBit(t_binary)) {
+        return t_binary;
+    } else {
+        return t_discarded;
+    }
+}
+
+template<typename Alloc>
+struct ColumnsBuilder {
+    Alloc& alloc;
+    unsigned rows;
+    ColumnInfo* infos = nullptr;
+    unsigned count = 0;
+    unsigned capacity = 0;
+    unsigned* hints = nullptr;
+    unsigned hintsCapacity = 0;
+    Column* columns = nullptr;
+    // row + 1 in which the column was last seen, null values included
+    unsigned* seen = nullptr;
+
+    bool reserveHints(unsigned size) noexcept {
+        if (size <= hintsCapacity) {
+            return true;
+        }
+        auto fresh = allocArray<unsigned>(alloc, size);
+        if (!fresh) [[unlikely]] return false;
+        memset(fresh, 0, sizeof(unsigned) * size);
+        hints = fresh;
+        hintsCapacity = size;
+        return true;
+    }
+
+    std::string_view insertInfo(unsigned pos, std::string_view name) noexcept {
+        if (count == capacity) {
+            auto grown = capacity ? capacity * 2 : 16;
+            auto fresh = allocArray<ColumnInfo>(alloc, grown);
+            if (!fresh) [[unlikely]] return "unexpected oom";
+            if (count) {
+                memcpy((void*)fresh, infos, sizeof(ColumnInfo) * count);
+            }
+            infos = fresh;
+            capacity = grown;
+        }
+        memmove((void*)(infos + pos + 1), infos + pos, sizeof(ColumnInfo) * (count - pos));
+        infos[pos] = ColumnInfo{.name = name};
+        ++count;
+        return {};
+    }
+
+    std::string_view infer(JsonView record) noexcept {
+        if (record.type() != t_object) [[unlikely]] return "record is not a map";
+        if (!reserveHints(record.GetData().size)) [[unlikely]] return "unexpected oom";
+        unsigned idx = 0;
+        for (auto& [k, v]: record.Object()) {
+            if (k.type() != t_string) [[unlikely]] return "non-string key";
+            auto name = k.String();
+            auto pos = findColumn(infos, count, name, hints[idx++]);
+            if (pos == count || infos[pos].name != name) {
+                if (auto err = insertInfo(pos, name); !err.empty()) [[unlikely]] return err;
+            }
+            auto& info = infos[pos];
+            auto type = normalType(v);
+            info.types |= typeBit(type);
+            if (type == t_uint && v.GetData().uinteger > uintmax_t(std::numeric_limits<int64_t>::max())) {
+                info.bigUint = true;
+            } else if (type == t_string || type == t_binary) {
+                info.bytes += v.GetData().size;
+            }
+        }
+        return {};
+    }
+
+    std::string_view allocate() noexcept {
+        columns = allocArray<Column>(alloc, count);
+        seen = allocArray<unsigned>(alloc, count);
+        if (!columns || !seen) [[unlikely]] return "unexpected oom";
+        memset(seen, 0, sizeof(unsigned) * count);
+        auto bitmap = (size_t(rows) + 7) / 8;
+        for (unsigned i = 0; i < count; ++i) {
+            auto& info = infos[i];
+            auto& col = columns[i];
+            col = Column{};
+            col.name = info.name;
+            col.type = resolveColumn(info);
+            col.nulls = allocArray<uint8_t>(alloc, bitmap);
+            if (!col.nulls) [[unlikely]] return "unexpected oom";
+            memset(col.nulls, 0xff, bitmap);
+            void* values = nullptr;
+            switch (col.type) {
+            case t_discarded: return "unsupported column type";
+            case t_null: continue;
+            case t_bool: values = col.bools = allocArray<bool>(alloc, rows); break;
+            case t_int: values = col.ints = allocArray<int64_t>(alloc, rows); break;
+            case t_num: values = col.nums = allocArray<double>(alloc, rows); break;
+            default: {
+                if (info.bytes > std::numeric_limits<uint32_t>::max()) [[unlikely]] {
+                    return "column is too large";
+                }
+                col.data = allocArray<char>(alloc, info.bytes);
+                if (!col.data) [[unlikely]] return "unexpected oom";
+                col.offsets = allocArray<uint32_t>(alloc, size_t(rows) + 1);
+                if (!col.offsets) [[unlikely]] return "unexpected oom";
+                col.offsets[0] = 0;
+                // reused as write cursor
+                info.bytes = 0;
+                continue;
+            }
+            }
+            if (!values) [[unlikely]] return "unexpected oom";
+            memset(values, 0, (col.type == t_bool ? sizeof(bool) : 8) * rows);
+        }
+        return {};
+    }
+
+    std::string_view fill(unsigned row, JsonView record) noexcept {
+        if (record.type() != t_object) [[unlikely]] return "record is not a map";
+        unsigned idx = 0;
+        uint8_t bit = uint8_t(1u << (row % 8));
+        for (auto& [k, v]: record.Object()) {
+            if (k.type() != t_string) [[unlikely]] return "non-string key";
+            auto name = k.String();
+            auto pos = findColumn(columns, count, name, hints[idx++]);
+            if (pos == count || columns[pos].name != name) [[unlikely]] return "record changed between passes";
+            auto& col = columns[pos];
+            if (seen[pos] == row + 1) [[unlikely]] return "duplicate key";
+            seen[pos] = row + 1;
+            auto& data = v.GetData();
+            switch (v.type()) {
+            case t_null: continue;
+            case t_bool: col.bools[row] = data.boolean; break;
+            case t_int: {
+                if (col.type == t_num) {
+                    col.nums[row] = double(data.integer);
+                } else {
+                    col.ints[row] = data.integer;
+                }
+                break;
+            }
+            case t_uint: {
+                if (col.type == t_num) {
+                    col.nums[row] = double(data.uinteger);
+                } else {
+                    col.ints[row] = int64_t(data.uinteger);
+                }
+                break;
+            }
+            case t_num: col.nums[row] = data.number; break;
+            case t_string:
+            case t_binary: {
+                auto& cursor = infos[pos].bytes;
+                memcpy(col.data + cursor, data.string, data.size);
+                cursor += data.size;
+                break;
+            }
+            default: [[unlikely]] return "record changed between passes";
+            }
+            col.nulls[row / 8] &= uint8_t(~bit);
+        }
+        for (unsigned i = 0; i < count; ++i) {
+            if (columns[i].type == t_string || columns[i].type == t_binary) {
+                columns[i].offsets[row + 1] = uint32_t(infos[i].bytes);
+            }
+        }
+        return {};
+    }
+
+    template<typename ForEach>
+    Columns build(ForEach&& forEach) noexcept {
+        auto fail = [](std::string_view err) {
+            return Columns{.error = err};
+        };
+        auto err = forEach([this](unsigned, JsonView record) {
+            return infer(record);
+        });
+        if (!err.empty()) [[unlikely]] return fail(err);
+        if (!(err = allocate()).empty()) [[unlikely]] return fail(err);
+        err = forEach([this](unsigned row, JsonView record) {
+            return fill(row, record);
+        });
+        if (!err.empty()) [[unlikely]] return fail(err);
+        return Columns{.columns = columns, .count = count, .rows = rows};
+    }
+};
+
+// Bump allocator on top of 'upstream', that is reused for every record
+template<typename Alloc>
+struct ScratchAlloc {
+    Alloc& upstream;
+    char* buffer = nullptr;
+    size_t used = 0;
+    size_t capacity = 0;
+
+    [[nodiscard]] void* operator()(size_t sz) noexcept {
+        sz = (sz + alignof(JsonPair) - 1) & ~(alignof(JsonPair) - 1);
+        if (!buffer || used + sz > capacity) {
+            auto grown = std::max(capacity * 2, std::max(sz, size_t(4096)));
+            buffer = (char*)upstream(grown);
+            if (!buffer) [[unlikely]] return nullptr;
+            used = 0;
+            capacity = grown;
+        }
+        auto res = buffer + used;
+        used += sz;
+        return res;
+    }
+    void Reset() noexcept {
+        used = 0;
+    }
+};
+
+} //detail
+
+template<msgpack::alloc Alloc>
+Columns ToColumns(JsonView records, Alloc&& alloc) noexcept
+{
+    if (records.type() != t_array) [[unlikely]] {
+        return Columns{.error = "not an array"};
+    }
+    auto rows = records.GetData().size;
+    detail::ColumnsBuilder<Alloc> builder{alloc, rows};
+    return builder.build([&](auto&& fn) -> std::string_view {
+        for (unsigned row = 0; row < rows; ++row) {
+            if (auto err = fn(row, records.GetData().array[row]); !err.empty()) [[unlikely]] return err;
+        }
+        return {};
+    });
+}
+
+namespace msgpack
+{
+
+template<int flags, alloc Alloc>
+Columns ParseColumns(std::string_view buffer, Alloc&& alloc, unsigned depthLimit) noexcept
+{
+    auto fail = [](JsonView err) {
+        return Columns{.error = {err.GetData().string, err.GetData().size}};
+    };
+    if (buffer.empty()) [[unlikely]] return fail(detail::ErrEOF);
+    if (!depthLimit) [[unlikely]] return fail(detail::ErrTooDeep);
+    auto head = uint8_t(buffer.front());
+    buffer = buffer.substr(1);
+    JsonView len;
+    if ((head & 0xf0) == 0x90) {
+        len = JsonView(head & 0b1111u);
+    } else if (head == 0xdc) {
+        len = detail::unpackTrivial<flags, uint16_t>(buffer);
+    } else if (head == 0xdd) {
+        len = detail::unpackTrivial<flags, uint32_t>(buffer);
+    } else {
+        return Columns{.error = "not an array"};
+    }
+    if (!len.Valid()) [[unlikely]] return fail(len);
+    auto rows = unsigned(len.GetData().uinteger);
+    mjv::detail::ColumnsBuilder<Alloc> builder{alloc, rows};
+    mjv::detail::ScratchAlloc<Alloc> scratch{alloc};
+    return builder.build([&](auto&& fn) -> std::string_view {
+        auto data = buffer;
+        for (unsigned row = 0; row < rows; ++row) {
+            scratch.Reset();
+            auto record = detail::parseOne<flags>(data, scratch, depthLimit - 1);
+            if (!record.Valid()) [[unlikely]] return {record.GetData().string, record.GetData().size};
+            if (auto err = fn(row, record); !err.empty()) [[unlikely]] return err;
+        }
+        return {};
+    });
+}
+
+template<int flags, writer Writer>
+constexpr auto Dump(Columns const& cols, Writer&& out) noexcept
+{
+    using namespace detail;
+    if (auto err = writeArrayHeader<flags>(cols.rows, out)) [[unlikely]] return err;
+    for (unsigned row = 0; row < cols.rows; ++row) {
+        if (auto err = writeMapHeader<flags>(cols.count, out)) [[unlikely]] return err;
+        for (auto& col: cols) {
+            if (auto err = writeString<flags>(col.name, out)) [[unlikely]] return err;
+            if (auto err = Dump<flags>(col[row], out)) [[unlikely]] return err;
+        }
+    }
+    return out(std::string_view{});
+}
+
+} //msgpack
+
+} //mjv
+
+#endif //JV_COLUMNS_HPP
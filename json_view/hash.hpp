@@ -0,0 +1,475 @@
+#ifndef JV_HASH_HPP
+#define JV_HASH_HPP
+#pragma once
+
+#include "json_view.hpp"
+#include <bit>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <string.h>
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+namespace mjv
+{
+
+// Structural 64-bit hash: object key order does not matter, non-negative t_int and t_uint
+// of the same value hash equally, -0.0 == 0.0 and all NaNs are the same.
+inline uint64_t Hash(JsonView j, unsigned depthLimit = 30) noexcept;
+
+// Structural equality consistent with Hash(). Objects are compared as multisets
+// of pairs, so {a:1,a:1} != {a:1,b:1}. Objects with different key order are sorted
+// in a scratch buffer allocated with global nothrow new
+inline bool Equal(JsonView a, JsonView b, unsigned depthLimit = 30) noexcept;
+
+// Total order consistent with Equal(): returns 0 only for Equal() values.
+// Types are ordered first, then scalars by value, strings and binaries bytewise,
+// arrays lexicographically, objects by size, Hash() and then by their sorted pairs.
+// Comparing objects allocates a scratch buffer with global nothrow new
+inline int Compare(JsonView a, JsonView b, unsigned depthLimit = 30) noexcept;
+
+namespace detail {
+
+inline constexpr uint64_t hashPrime32 = 0x9E3779B1u;
+inline constexpr uint64_t hashPrime64_1 = 0x9E3779B185EBCA87ull;
+inline constexpr uint64_t hashPrime64_2 = 0xC2B2AE3D27D4EB4Full;
+inline constexpr uint64_t hashPrime64_3 = 0x165667B19E3779F9ull;
+
+inline constexpr uint64_t hashSecret[8] = {
+    0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+    0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull,
+};
+
+[[gnu::always_inline]]
+inline uint64_t readLE64(const char* p) noexcept {
+    uint64_t res;
+    memcpy(&res, p, sizeof(res));
+    if constexpr (std::endian::native == std::endian::big) {
+        res = __builtin_bswap64(res);
+    }
+    return res;
+}
+
+[[gnu::always_inline]]
+inline uint32_t readLE32(const char* p) noexcept {
+    uint32_t res;
+    memcpy(&res, p, sizeof(res));
+    if constexpr (std::endian::native == std::endian::big) {
+        res = __builtin_bswap32(res);
+    }
+    return res;
+}
+
+[[gnu::always_inline]]
+inline constexpr uint64_t hashMix(uint64_t a, uint64_t b) noexcept {
+    auto res = __uint128_t(a) * b;
+    return uint64_t(res) ^ uint64_t(res >> 64);
+}
+
+[[gnu::always_inline]]
+inline constexpr uint64_t hashAvalanche(uint64_t h) noexcept {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ull;
+    return h ^ (h >> 32);
+}
+
+inline constexpr size_t hashStripe = 64;
+inline constexpr size_t hashStripesPerScramble = 16;
+
+// 8 lanes of 64 bit, each stripe adds lo32(key) * hi32(key) to its own lane and raw data
+// to the neighbour lane. Salt differs per stripe to keep position of bytes significant,
+// as lanes are summed up. Compilers do not vectorize this by themselves (cross-lane add),
+// so SSE2/AVX2 versions are explicit; all variants produce the same result.
+[[gnu::always_inline]]
+inline void hashAccumulate(uint64_t (&acc)[8], const char* stripe, uint64_t salt) noexcept {
+    for (size_t i = 0; i < 8; ++i) {
+        auto data = readLE64(stripe + 8 * i);
+        auto key = data ^ (hashSecret[i] + salt);
+        acc[i ^ 1] += data;
+        acc[i] += (key & 0xffffffff) * (key >> 32);
+    }
+}
+
+// Accumulates 'count' consecutive stripes, 'first' is the index of the first one
+inline void hashStripes(uint64_t (&acc)[8], const char* p, size_t first, size_t count) noexcept {
+#if defined(__AVX2__)
+    __m256i lanes[2];
+    __m256i secret[2];
+    for (size_t j = 0; j < 2; ++j) {
+        lanes[j] = _mm256_loadu_si256((const __m256i*)(acc + 4 * j));
+        secret[j] = _mm256_loadu_si256((const __m256i*)(hashSecret + 4 * j));
+    }
+    for (size_t s = 0; s < count; ++s) {
+        auto salt = _mm256_set1_epi64x(int64_t((first + s) * hashPrime64_3));
+        #pragma GCC unroll 2
+        for (size_t j = 0; j < 2; ++j) {
+            auto data = _mm256_loadu_si256((const __m256i*)(p + s * hashStripe + 32 * j));
+            auto key = _mm256_xor_si256(data, _mm256_add_epi64(secret[j], salt));
+            auto prod = _mm256_mul_epu32(key, _mm256_srli_epi64(key, 32));
+            auto swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            lanes[j] = _mm256_add_epi64(lanes[j], _mm256_add_epi64(prod, swapped));
+        }
+    }
+    for (size_t j = 0; j < 2; ++j) {
+        _mm256_storeu_si256((__m256i*)(acc + 4 * j), lanes[j]);
+    }
+#elif defined(__SSE2__)
+    __m128i lanes[4];
+    __m128i secret[4];
+    for (size_t j = 0; j < 4; ++j) {
+        lanes[j] = _mm_loadu_si128((const __m128i*)(acc + 2 * j));
+        secret[j] = _mm_loadu_si128((const __m128i*)(hashSecret + 2 * j));
+    }
+    for (size_t s = 0; s < count; ++s) {
+        auto salt = _mm_set1_epi64x(int64_t((first + s) * hashPrime64_3));
+        #pragma GCC unroll 4
+        for (size_t j = 0; j < 4; ++j) {
+            auto data = _mm_loadu_si128((const __m128i*)(p + s * hashStripe + 16 * j));
+            auto key = _mm_xor_si128(data, _mm_add_epi64(secret[j], salt));
+            auto prod = _mm_mul_epu32(key, _mm_srli_epi64(key, 32));
+            auto swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            lanes[j] = _mm_add_epi64(lanes[j], _mm_add_epi64(prod, swapped));
+        }
+    }
+    for (size_t j = 0; j < 4; ++j) {
+        _mm_storeu_si128((__m128i*)(acc + 2 * j), lanes[j]);
+    }
+#else
+    for (size_t s = 0; s < count; ++s) {
+        hashAccumulate(acc, p + s * hashStripe, (first + s) * hashPrime64_3);
+    }
+#endif
+}
+
+[[gnu::always_inline]]
+inline void hashScramble(uint64_t (&acc)[8]) noexcept {
+    for (size_t i = 0; i < 8; ++i) {
+        acc[i] ^= acc[i] >> 47;
+        acc[i] ^= hashSecret[(i + 3) & 7];
+        acc[i] *= hashPrime32;
+    }
+}
+
+inline uint64_t hashLong(const char* p, size_t len) noexcept {
+    uint64_t acc[8] = {
+        hashPrime32, hashPrime64_1, hashPrime64_2, hashPrime64_3,
+        ~hashPrime32, ~hashPrime64_1, ~hashPrime64_2, ~hashPrime64_3,
+    };
+    size_t stripes = (len - 1) / hashStripe;
+    for (size_t s = 0; s < stripes; s += hashStripesPerScramble) {
+        auto count = std::min(hashStripesPerScramble, stripes - s);
+        hashStripes(acc, p + s * hashStripe, s, count);
+        if (count == hashStripesPerScramble) {
+            hashScramble(acc);
+        }
+    }
+    hashStripes(acc, p + len - hashStripe, stripes, 1);
+    uint64_t h = len * hashPrime64_1;
+    for (size_t i = 0; i < 8; i += 2) {
+        h += hashMix(acc[i] ^ hashSecret[(i + 5) & 7], acc[i + 1] ^ hashSecret[(i + 6) & 7]);
+    }
+    return hashAvalanche(h);
+}
+
+inline uint64_t hashBytes(std::string_view sv) noexcept {
+    auto p = sv.data();
+    auto len = sv.size();
+    if (len > 128) [[unlikely]] {
+        return hashLong(p, len);
+    } else if (len > 16) {
+        uint64_t h = len * hashPrime64_1;
+        for (size_t i = 0; i + 16 < len; i += 16) {
+            h += hashMix(readLE64(p + i) ^ (hashSecret[(i >> 3) & 7] + i),
+                         readLE64(p + i + 8) ^ (hashSecret[((i >> 3) + 1) & 7] - i));
+        }
+        h += hashMix(readLE64(p + len - 16) ^ hashSecret[6], readLE64(p + len - 8) ^ hashSecret[7]);
+        return hashAvalanche(h);
+    } else if (len > 8) {
+        auto lo = readLE64(p) ^ hashSecret[0];
+        auto hi = readLE64(p + len - 8) ^ hashSecret[1];
+        return hashAvalanche(hashMix(lo, hi) + len * hashPrime64_1);
+    } else if (len >= 4) {
+        uint64_t v = (uint64_t(readLE32(p)) << 32) | readLE32(p + len - 4);
+        return hashAvalanche(hashMix(v ^ hashSecret[2], hashSecret[3] + len));
+    } else if (len) {
+        uint64_t v = uint64_t(uint8_t(p[0])) << 16
+                     | uint64_t(uint8_t(p[len >> 1])) << 24
+                     | uint64_t(uint8_t(p[len - 1]))
+                     | uint64_t(len) << 8;
+        return hashAvalanche(hashMix(v ^ hashSecret[4], hashSecret[5]));
+    } else {
+        return hashAvalanche(hashSecret[6] ^ hashSecret[7]);
+    }
+}
+
+[[gnu::always_inline]]
+inline constexpr uint64_t hashTag(Types t, uint64_t payload) noexcept {
+    return hashMix(uint64_t(t) ^ hashSecret[t & 7], payload ^ hashPrime64_2);
+}
+
+// t_int that fits into t_uint is treated as t_uint
+[[gnu::always_inline]]
+inline constexpr Types normalType(JsonView j) noexcept {
+    if (j.type() == t_int && j.GetData().integer >= 0) {
+        return t_uint;
+    }
+    return j.type();
+}
+
+[[gnu::always_inline]]
+inline uint64_t hashDouble(double d) noexcept {
+    if (d != d) {
+        return 0x7ff8000000000000ull;
+    } else if (d == 0) {
+        return 0;
+    } else {
+        return std::bit_cast<uint64_t>(d);
+    }
+}
+
+inline int comparePairs(JsonPair const& a, JsonPair const& b, unsigned depthLimit) noexcept {
+    if (auto res = Compare(a.key, b.key, depthLimit)) {
+        return res;
+    }
+    return Compare(a.value, b.value, depthLimit);
+}
+
+struct HashedPair {
+    uint64_t key;
+    uint64_t value;
+    const JsonPair* pair;
+
+    static HashedPair From(JsonPair const& p, unsigned depthLimit) noexcept {
+        return {Hash(p.key, depthLimit), Hash(p.value, depthLimit), &p};
+    }
+};
+
+// Pointers to 'count' pairs, sorted by 'less'. nullptr if scratch buffer could not be allocated
+template<typename Less>
+inline std::unique_ptr<const JsonPair*[]> sortedPairs(const JsonPair* pairs, unsigned count, Less&& less) noexcept {
+    std::unique_ptr<const JsonPair*[]> sorted{new (std::nothrow) const JsonPair*[count ? count : 1]};
+    if (!sorted) [[unlikely]] return sorted;
+    for (unsigned i = 0; i < count; ++i) {
+        sorted[i] = pairs + i;
+    }
+    std::sort(sorted.get(), sorted.get() + count, less);
+    return sorted;
+}
+
+} //detail
+
+inline uint64_t Hash(JsonView j, unsigned depthLimit) noexcept
+{
+    using namespace detail;
+    auto type = normalType(j);
+    if (depthLimit == 0) [[unlikely]] {
+        return hashTag(type, 0);
+    }
+    auto& data = j.GetData();
+    switch (type)
+    {
+    case t_bool: return hashTag(t_bool, data.boolean);
+    case t_int:
+    case t_uint: return hashTag(type, data.uinteger);
+    case t_num: return hashTag(t_num, hashDouble(data.number));
+    case t_string:
+    case t_binary: return hashTag(type, hashBytes({data.string, data.size}));
+    case t_array: {
+        uint64_t h = hashTag(t_array, data.size);
+        for (auto v: j.Array()) {
+            h = hashMix(h ^ Hash(v, depthLimit - 1), hashPrime64_1);
+        }
+        return h;
+    }
+    case t_object: {
+        // commutative sum of pairs -> independent of key order
+        uint64_t sum = 0;
+        for (auto& [k, v]: j.Object()) {
+            sum += hashMix(Hash(k, depthLimit - 1) ^ hashPrime64_3, Hash(v, depthLimit - 1) ^ hashPrime64_2);
+        }
+        return hashMix(hashTag(t_object, data.size), sum ^ hashPrime64_1);
+    }
+    default: return hashTag(type, 0);
+    }
+}
+
+inline bool Equal(JsonView a, JsonView b, unsigned depthLimit) noexcept
+{
+    using namespace detail;
+    auto type = normalType(a);
+    if (type != normalType(b)) {
+        return false;
+    }
+    if (depthLimit == 0) [[unlikely]] {
+        return false;
+    }
+    auto& l = a.GetData();
+    auto& r = b.GetData();
+    switch (type)
+    {
+    case t_bool: return l.boolean == r.boolean;
+    case t_int:
+    case t_uint: return l.uinteger == r.uinteger;
+    case t_num: return l.number == r.number || (l.number != l.number && r.number != r.number);
+    case t_string:
+    case t_binary: {
+        return std::string_view{l.string, l.size} == std::string_view{r.string, r.size};
+    }
+    case t_array: {
+        if (l.size != r.size) {
+            return false;
+        }
+        for (unsigned i = 0; i < l.size; ++i) {
+            if (!Equal(l.array[i], r.array[i], depthLimit - 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case t_object: {
+        if (l.size != r.size) {
+            return false;
+        }
+        auto same = [depthLimit](JsonPair const& x, JsonPair const& y) {
+            return Equal(x.key, y.key, depthLimit - 1) && Equal(x.value, y.value, depthLimit - 1);
+        };
+        // same key order is the common case -> compare pairwise first
+        unsigned i = 0;
+        while (i < l.size && same(l.object[i], r.object[i])) {
+            ++i;
+        }
+        // the rest must be equal multisets of pairs (maps may have duplicate keys):
+        // sort both sides by pair hashes, Compare() only breaks ties
+        auto rest = l.size - i;
+        if (!rest) {
+            return true;
+        }
+        std::unique_ptr<HashedPair[]> lsorted{new (std::nothrow) HashedPair[rest]};
+        std::unique_ptr<HashedPair[]> rsorted{new (std::nothrow) HashedPair[rest]};
+        if (lsorted && rsorted) [[likely]] {
+            for (unsigned j = 0; j < rest; ++j) {
+                lsorted[j] = HashedPair::From(l.object[i + j], depthLimit - 1);
+                rsorted[j] = HashedPair::From(r.object[i + j], depthLimit - 1);
+            }
+            auto less = [depthLimit](HashedPair const& x, HashedPair const& y) {
+                if (x.key != y.key) {
+                    return x.key < y.key;
+                } else if (x.value != y.value) {
+                    return x.value < y.value;
+                }
+                return comparePairs(*x.pair, *y.pair, depthLimit - 1) < 0;
+            };
+            std::sort(lsorted.get(), lsorted.get() + rest, less);
+            std::sort(rsorted.get(), rsorted.get() + rest, less);
+            for (unsigned j = 0; j < rest; ++j) {
+                auto& x = lsorted[j];
+                auto& y = rsorted[j];
+                if (x.key != y.key || x.value != y.value || !same(*x.pair, *y.pair)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        // out of memory: count every distinct pair on both sides, O(n^2)
+        for (unsigned j = i; j < l.size; ++j) {
+            auto& pair = l.object[j];
+            bool counted = false;
+            for (unsigned k = i; k < j && !counted; ++k) {
+                counted = same(l.object[k], pair);
+            }
+            if (counted) {
+                continue;
+            }
+            unsigned left = 0;
+            unsigned right = 0;
+            for (unsigned k = j; k < l.size; ++k) {
+                left += same(l.object[k], pair);
+            }
+            for (unsigned k = i; k < r.size; ++k) {
+                right += same(r.object[k], pair);
+            }
+            if (left != right) {
+                return false;
+            }
+        }
+        return true;
+    }
+    default: return true;
+    }
+}
+
+inline int Compare(JsonView a, JsonView b, unsigned depthLimit) noexcept
+{
+    using namespace detail;
+    auto cmp = [](auto x, auto y) {
+        return x < y ? -1 : y < x ? 1 : 0;
+    };
+    auto type = normalType(a);
+    if (auto res = cmp(type, normalType(b))) {
+        return res;
+    }
+    if (depthLimit == 0) [[unlikely]] {
+        return 0;
+    }
+    auto& l = a.GetData();
+    auto& r = b.GetData();
+    switch (type)
+    {
+    case t_bool: return cmp(l.boolean, r.boolean);
+    case t_int: return cmp(l.integer, r.integer);
+    case t_uint: return cmp(l.uinteger, r.uinteger);
+    case t_num: {
+        bool lnan = l.number != l.number;
+        bool rnan = r.number != r.number;
+        if (lnan || rnan) {
+            return cmp(lnan, rnan);
+        }
+        return cmp(l.number, r.number);
+    }
+    case t_string:
+    case t_binary: {
+        auto res = std::string_view{l.string, l.size}.compare(std::string_view{r.string, r.size});
+        return cmp(res, 0);
+    }
+    case t_array: {
+        for (unsigned i = 0; i < l.size && i < r.size; ++i) {
+            if (auto res = Compare(l.array[i], r.array[i], depthLimit - 1)) {
+                return res;
+            }
+        }
+        return cmp(l.size, r.size);
+    }
+    case t_object: {
+        if (auto res = cmp(l.size, r.size)) {
+            return res;
+        }
+        if (auto res = cmp(Hash(a, depthLimit), Hash(b, depthLimit))) {
+            return res;
+        }
+        auto less = [depthLimit](const JsonPair* x, const JsonPair* y) {
+            return comparePairs(*x, *y, depthLimit - 1) < 0;
+        };
+        auto lsorted = sortedPairs(l.object, l.size, less);
+        auto rsorted = sortedPairs(r.object, r.size, less);
+        if (!lsorted || !rsorted) [[unlikely]] {
+            // out of memory: still 0 only for Equal() objects
+            return Equal(a, b, depthLimit) ? 0 : cmp(l.object, r.object);
+        }
+        for (unsigned i = 0; i < l.size; ++i) {
+            if (auto res = comparePairs(*lsorted[i], *rsorted[i], depthLimit - 1)) {
+                return res;
+            }
+        }
+        return 0;
+    }
+    default: return 0;
+    }
+}
+
+} //mjv
+
+#endif //JV_HASH_HPP
@@ -3,7 +3,12 @@
 #pragma once
 
 #include "json_view.hpp"
+#include "hash.hpp"
 #include <type_traits>
+#include <bit>
+#include <algorithm>
+#include <memory>
+#include <new>
 #include <limits>
 #include <string.h>
 #include <stdlib.h>
@@ -31,6 +36,12 @@ concept alloc = requires(Fn f, size_t sz)
 enum Flags {
     Default = 0,
     NativeEndian = 1,
+    // Sort map keys and use the smallest encodings (float32 when lossless),
+    // so that Equal() trees produce identical bytes. Unlike other flags this allocates:
+    // maps over 32 keys (and map keys/values that are maps) are sorted in a scratch
+    // buffer from global nothrow new, not from the Parse() allocator. Without memory
+    // it falls back to a slower allocation-free scan
+    Canonical = 2,
 };
 
 using CannotFail = std::false_type;
@@ -39,7 +50,7 @@ template<int flags = Default, writer Writer>
 constexpr auto Dump(JsonView j, Writer&& out, unsigned depthLimit = 30) noexcept;
 
 template<int flags = Default, alloc Alloc>
-constexpr JsonView Parse(std::string_view buffer, Alloc&& out, unsigned depthLimit = 30) noexcept;
+constexpr JsonView Parse(std::string_view buffer, Alloc&& out, unsigned depthLimit = 30, size_t* consumed = nullptr) noexcept;
 
 namespace detail {
 
@@ -49,7 +60,10 @@ template<typename T> concept bswappable = std::integral<T> || std::floating_poin
 static inline constexpr auto bswap(bswappable auto val) noexcept
     requires (sizeof(val) <= 8)
 {
-    if constexpr (sizeof(val) == 1) {
+    if constexpr (std::floating_point<decltype(val)>) {
+        using bits = std::conditional_t<sizeof(val) == 4, uint32_t, uint64_t>;
+        return std::bit_cast<decltype(val)>(bswap(std::bit_cast<bits>(val)));
+    } else if constexpr (sizeof(val) == 1) {
         return val;
     } else if constexpr (sizeof(val) == 2) {
         return __builtin_bswap16(val);
@@ -132,6 +146,34 @@ constexpr auto writeBin(std::string_view sv, Writer& out)
     return out(sv);
 }
 
+template<int flags, typename Writer>
+constexpr auto writeArrayHeader(unsigned sz, Writer& out)
+{
+    if (sz <= 0b1111) {
+        return writeType<flags>(uint8_t(0b10010000 | sz), out);
+    } else if (sz <= std::numeric_limits<uint16_t>::max()) {
+        if (auto err = writeType<flags>(0xdc, out)) [[unlikely]] return err;
+        return write<flags>(uint16_t(sz), out);
+    } else {
+        if (auto err = writeType<flags>(0xdd, out)) [[unlikely]] return err;
+        return write<flags>(uint32_t(sz), out);
+    }
+}
+
+template<int flags, typename Writer>
+constexpr auto writeMapHeader(unsigned sz, Writer& out)
+{
+    if (sz <= 0b1111)  {
+        return writeType<flags>(uint8_t(0b10000000 | sz), out);
+    } else if (sz <= std::numeric_limits<uint16_t>::max()) {
+        if (auto err = writeType<flags>(0xde, out)) [[unlikely]] return err;
+        return write<flags>(uint16_t(sz), out);
+    } else {
+        if (auto err = writeType<flags>(0xdf, out)) [[unlikely]] return err;
+        return write<flags>(uint32_t(sz), out);
+    }
+}
+
 template<int flags, typename Writer>
 constexpr auto writeNegInt(int64_t i, Writer& out) {
     if (i >= -32) {
@@ -170,6 +212,50 @@ constexpr auto writePosInt(uint64_t i, Writer& out) {
     }
 }
 
+[[gnu::always_inline]]
+inline constexpr bool fitsFloat(double num) noexcept {
+    constexpr auto fmax = double(std::numeric_limits<float>::max());
+    if (num != num || num == std::numeric_limits<double>::infinity() || num == -std::numeric_limits<double>::infinity()) {
+        return true;
+    }
+    return num >= -fmax && num <= fmax && double(float(num)) == num;
+}
+
+inline constexpr unsigned canonicalBatch = 32;
+
+// Keys first, then values, so pairs with equal keys (duplicates, -0.0 and 0.0) still
+// get a fixed order. Address only breaks ties of Equal() pairs, which dump identically
+inline bool pairLess(const JsonPair* a, const JsonPair* b) noexcept {
+    auto res = mjv::detail::comparePairs(*a, *b, 30);
+    return res < 0 || (res == 0 && a < b);
+}
+
+// Collects up to canonicalBatch smallest pairs that come after 'prev' (all if null).
+// Itself allocation-free: maps up to canonicalBatch keys are insertion-sorted in one pass.
+// Larger ones are only batched if sortedPairs() fails, at one extra pass per batch
+inline unsigned nextSortedPairs(AsObject obj, const JsonPair* prev, const JsonPair* (&batch)[canonicalBatch]) noexcept {
+    auto less = pairLess;
+    unsigned count = 0;
+    for (auto& pair: obj) {
+        auto curr = &pair;
+        if (prev && !less(prev, curr)) {
+            continue;
+        }
+        if (count == canonicalBatch) {
+            if (!less(curr, batch[count - 1])) {
+                continue;
+            }
+            --count;
+        }
+        auto pos = count++;
+        for (; pos && less(curr, batch[pos - 1]); --pos) {
+            batch[pos] = batch[pos - 1];
+        }
+        batch[pos] = curr;
+    }
+    return count;
+}
+
 #define _JV_CHECK(x) if ((x).type() == t_discarded) [[unlikely]] return (x)
 
 inline constexpr auto ErrEOF = JsonView::Discarded("unexpected eof");
@@ -394,6 +480,16 @@ constexpr auto Dump(JsonView j, Writer&& out, unsigned depthLimit) noexcept {
         return writePosInt<flags>(j.GetData().integer, out);
     }
     case t_num: {
+        if constexpr (bool(flags & Canonical)) {
+            auto num = j.GetData().number;
+            if (num == 0) {
+                num = 0; // -0.0
+            }
+            if (fitsFloat(num)) {
+                if (auto err = writeType<flags>(uint8_t(0xca), out)) [[unlikely]] return err;
+                return write<flags>(num != num ? std::numeric_limits<float>::quiet_NaN() : float(num), out);
+            }
+        }
         if (auto err = writeType<flags>(uint8_t(0xcb), out)) [[unlikely]] return err;
         return write<flags>(j.GetData().number, out);
     }
@@ -404,31 +500,35 @@ constexpr auto Dump(JsonView j, Writer&& out, unsigned depthLimit) noexcept {
         return writeBin<flags>(j.Bin(), out);
     }
     case t_array: {
-        auto sz = j.GetData().size;
-        if (sz <= 0b1111) {
-            if (auto err = writeType<flags>(uint8_t(0b10010000 | sz), out)) [[unlikely]] return err;
-        } else if (sz <= std::numeric_limits<uint16_t>::max()) {
-            if (auto err = writeType<flags>(0xdc, out)) [[unlikely]] return err;
-            if (auto err = write<flags>(uint16_t(sz), out)) [[unlikely]] return err;
-        } else {
-            if (auto err = writeType<flags>(0xdd, out)) [[unlikely]] return err;
-            if (auto err = write<flags>(uint32_t(sz), out)) [[unlikely]] return err;
-        }
+        if (auto err = writeArrayHeader<flags>(j.GetData().size, out)) [[unlikely]] return err;
         for (auto v: j.Array()) {
             if (auto err = Dump<flags>(v, out, depthLimit - 1)) [[unlikely]] return err;
         }
         return out(std::string_view{});
     }
     case t_object: {
-        auto sz = j.GetData().size;
-        if (sz <= 0b1111)  {
-            if (auto err = writeType<flags>(uint8_t(0b10000000 | sz), out)) [[unlikely]] return err;
-        } else if (sz <= std::numeric_limits<uint16_t>::max()) {
-            if (auto err = writeType<flags>(0xde, out)) [[unlikely]] return err;
-            if (auto err = write<flags>(uint16_t(sz), out)) [[unlikely]] return err;
-        } else {
-            if (auto err = writeType<flags>(0xdf, out)) [[unlikely]] return err;
-            if (auto err = write<flags>(uint32_t(sz), out)) [[unlikely]] return err;
+        if (auto err = writeMapHeader<flags>(j.GetData().size, out)) [[unlikely]] return err;
+        if constexpr (bool(flags & Canonical)) {
+            auto sz = j.GetData().size;
+            if (sz > canonicalBatch) {
+                if (auto sorted = mjv::detail::sortedPairs(j.GetData().object, sz, pairLess)) [[likely]] {
+                    for (unsigned i = 0; i < sz; ++i) {
+                        if (auto err = Dump<flags>(sorted[i]->key, out, depthLimit - 1)) [[unlikely]] return err;
+                        if (auto err = Dump<flags>(sorted[i]->value, out, depthLimit - 1)) [[unlikely]] return err;
+                    }
+                    return out(std::string_view{});
+                }
+            }
+            const JsonPair* batch[canonicalBatch];
+            const JsonPair* prev = nullptr;
+            while (auto count = nextSortedPairs(j.Object(), prev, batch)) {
+                for (unsigned i = 0; i < count; ++i) {
+                    if (auto err = Dump<flags>(batch[i]->key, out, depthLimit - 1)) [[unlikely]] return err;
+                    if (auto err = Dump<flags>(batch[i]->value, out, depthLimit - 1)) [[unlikely]] return err;
+                }
+                prev = batch[count - 1];
+            }
+            return out(std::string_view{});
         }
         for (auto [k, v]: j.Object()) {
             if (auto err = Dump<flags>(k, out, depthLimit - 1)) [[unlikely]] return err;
@@ -447,7 +547,7 @@ constexpr auto Dump(JsonView j, Writer&& out, unsigned depthLimit) noexcept {
 }
 
 template<int flags, alloc Alloc>
-constexpr JsonView Parse(std::string_view buffer, Alloc&& alloc, unsigned depthLimit, size_t* consumed = nullptr) noexcept {
+constexpr JsonView Parse(std::string_view buffer, Alloc&& alloc, unsigned depthLimit, size_t* consumed) noexcept {
     auto was = buffer.size();
     auto res = detail::parseOne<flags>(buffer, alloc, depthLimit);
     if (consumed) {
@@ -1,6 +1,9 @@
 #include "json_view/json_view.hpp"
 #include "json_view/msgpack.hpp"
+#include "json_view/hash.hpp"
+#include "json_view/columns.hpp"
 #include <string>
+#include <vector>
 
 int main(int argc, char *argv[])
 {
@@ -18,5 +21,149 @@ int main(int argc, char *argv[])
     auto back = Parse(serial, ctx);
     auto str = back[3][1];
     assert(str.String() == "123");
+    assert(Equal(back, JsonView(top)));
+    assert(Hash(back) == Hash(JsonView(top)));
+
+    std::string bigStr(1000, 'x');
+    std::string_view big = bigStr;
+    JsonPair one[] = {{"a", 1}, {"b", 2.5}, {"c", big}, {"d", JsonView::Binary("bin")}, {"e", 0.1}};
+    JsonPair two[] = {{"e", 0.1}, {"d", JsonView::Binary("bin")}, {"c", big}, {"a", 1u}, {"b", 2.5f}};
+    JsonPair other[] = {{"a", 1}, {"b", 2.5}, {"c", big.substr(1)}, {"d", JsonView::Binary("bin")}, {"e", 0.1}};
+    assert(Equal(one, two));
+    assert(Hash(one) == Hash(two));
+    assert(!Equal(one, other));
+    assert(Hash(one) != Hash(other));
+    assert(!Equal(JsonView("bin"), JsonView::Binary("bin")));
+    JsonPair dupA[] = {{"a", 1}, {"a", 1}};
+    JsonPair dupB[] = {{"a", 1}, {"b", 1}};
+    JsonPair dupC[] = {{"b", 2}, {"a", 1}, {"a", 2}};
+    JsonPair dupD[] = {{"a", 2}, {"b", 2}, {"a", 1}};
+    assert(!Equal(dupA, dupB) && !Equal(dupB, dupA));
+    assert(Hash(dupA) != Hash(dupB));
+    assert(Equal(dupC, dupD) && Equal(dupD, dupC));
+    assert(Hash(dupC) == Hash(dupD));
+    std::string canonC, canonD;
+    Dump<Canonical>(JsonView(dupC), [&](auto sv) -> CannotFail {
+        canonC += sv;
+        return {};
+    });
+    Dump<Canonical>(JsonView(dupD), [&](auto sv) -> CannotFail {
+        canonD += sv;
+        return {};
+    });
+    assert(canonC == canonD);
+    std::vector<std::string> bigKeys(20000);
+    std::vector<JsonPair> forward(bigKeys.size()), reversed(bigKeys.size());
+    for (unsigned i = 0; i < bigKeys.size(); ++i) {
+        bigKeys[i] = std::to_string(i);
+        forward[i] = JsonPair{std::string_view{bigKeys[i]}, i};
+        reversed[bigKeys.size() - 1 - i] = forward[i];
+    }
+    JsonView forwardView(forward.data(), unsigned(forward.size()));
+    JsonView reversedView(reversed.data(), unsigned(reversed.size()));
+    assert(Equal(forwardView, reversedView) && Hash(forwardView) == Hash(reversedView));
+    reversed[0].value = 1;
+    assert(!Equal(forwardView, reversedView) && !Equal(reversedView, forwardView));
+    JsonPair zeroA[] = {{-0.0, 1}, {0.0, 2}};
+    JsonPair zeroB[] = {{0.0, 2}, {-0.0, 1}};
+    assert(Compare(zeroA, zeroB) == 0 && Compare(dupA, dupB) != 0 && Compare(dupA, dupB) == -Compare(dupB, dupA));
+    std::string canonOne, canonTwo;
+    Dump<Canonical>(JsonView(one), [&](auto sv) -> CannotFail {
+        canonOne += sv;
+        return {};
+    });
+    Dump<Canonical>(JsonView(two), [&](auto sv) -> CannotFail {
+        canonTwo += sv;
+        return {};
+    });
+    assert(canonOne == canonTwo);
+    assert(Equal(Parse(canonOne, ctx), JsonView(one)));
+
+    JsonPair many[40];
+    std::string keys[40];
+    for (int i = 0; i < 40; ++i) {
+        keys[i] = std::to_string(39 - i);
+        many[i] = JsonPair{std::string_view{keys[i]}, i};
+    }
+    std::string canonMany;
+    Dump<Canonical>(JsonView(many), [&](auto sv) -> CannotFail {
+        canonMany += sv;
+        return {};
+    });
+    auto sorted = Parse(canonMany, ctx);
+    assert(Equal(sorted, JsonView(many)));
+    for (unsigned i = 1; i < 40; ++i) {
+        assert(sorted.GetData().object[i - 1].key.String() < sorted.GetData().object[i].key.String());
+    }
+
+    JsonPair rec1[] = {{"id", 1}, {"name", "first"}, {"score", 1.5}, {"ok", true}};
+    JsonPair rec2[] = {{"score", 2}, {"id", 2u}, {"name", "second"}, {"ok", nullptr}};
+    JsonPair rec3[] = {{"id", -3}, {"name", ""}, {"score", 3.25}, {"ok", false}, {"extra", JsonView::Binary("x")}};
+    JsonView records[] = {rec1, rec2, rec3};
+    auto cols = ToColumns(JsonView(records), ctx);
+    assert(cols.Valid() && cols.rows == 3 && cols.count == 5);
+    assert(cols["id"]->type == t_int && cols["id"]->ints[2] == -3);
+    assert(cols["score"]->type == t_num && cols["score"]->nums[1] == 2.0);
+    assert(cols["ok"]->type == t_bool && cols["ok"]->IsNull(1) && !cols["ok"]->bools[2]);
+    assert(cols["name"]->type == t_string && cols["name"]->StringAt(1) == "second");
+    assert(cols["extra"]->type == t_binary && cols["extra"]->IsNull(0) && !cols["extra"]->IsNull(2));
+    assert(!cols["missing"]);
+    auto names = cols["name"];
+    assert(names->offsets[0] == 0 && names->offsets[1] == 5 && names->offsets[2] == 11 && names->offsets[3] == 11);
+    assert(names->StringAt(0) == "first" && names->StringAt(2) == "");
+
+    std::string recordsSerial;
+    Dump(JsonView(records), [&](auto sv) -> CannotFail {
+        recordsSerial += sv;
+        return {};
+    });
+    auto parsedCols = ParseColumns(recordsSerial, ctx);
+    assert(parsedCols.Valid() && parsedCols.rows == 3 && parsedCols.count == 5);
+    std::string colsSerial;
+    Dump(parsedCols, [&](auto sv) -> CannotFail {
+        colsSerial += sv;
+        return {};
+    });
+    auto roundtrip = Parse(colsSerial, ctx);
+    assert(Equal(roundtrip[2], JsonView(rec3)));
+    assert(roundtrip[0]["extra"].type() == t_null);
+    assert(roundtrip[1]["score"].type() == t_num);
+
+    JsonPair bad[] = {{"id", "not an int"}};
+    JsonView mixed[] = {rec1, bad};
+    assert(!ToColumns(JsonView(mixed), ctx).Valid());
+    assert(!ParseColumns(serial, ctx).Valid());
+
+    JsonPair none[1];
+    JsonView emptyFirst[] = {JsonView(none, 0), rec1};
+    auto emptyCols = ToColumns(JsonView(emptyFirst), ctx);
+    assert(emptyCols.Valid() && emptyCols.rows == 2 && emptyCols["id"]->IsNull(0));
+    std::string emptySerial;
+    Dump(JsonView(emptyFirst), [&](auto sv) -> CannotFail {
+        emptySerial += sv;
+        return {};
+    });
+    emptyCols = ParseColumns(emptySerial, ctx);
+    assert(emptyCols.Valid() && emptyCols.rows == 2 && emptyCols["id"]->ints[1] == 1);
+    assert(ParseColumns("\x91\x80", ctx).Valid());
+
+    JsonPair dupNullFirst[] = {{"a", nullptr}, {"a", 1}};
+    JsonPair dupNullLast[] = {{"a", 1}, {"a", nullptr}};
+    JsonView dupFirst[] = {dupNullFirst};
+    JsonView dupLast[] = {dupNullLast};
+    assert(ToColumns(JsonView(dupFirst), ctx).error == "duplicate key");
+    assert(ToColumns(JsonView(dupLast), ctx).error == "duplicate key");
+
+    JsonPair small[] = {{"n", 1}};
+    JsonPair huge[] = {{"n", uint64_t(1) << 63}};
+    JsonView promoted[] = {small, huge};
+    auto promotedCols = ToColumns(JsonView(promoted), ctx);
+    assert(promotedCols.Valid() && promotedCols["n"]->type == t_num);
+    assert(promotedCols["n"]->nums[0] == 1.0 && promotedCols["n"]->nums[1] == 9223372036854775808.0);
+
+    JsonView inner[] = {1, 2};
+    JsonPair nested[] = {{"n", inner}};
+    JsonView nestedRecords[] = {small, nested};
+    assert(ToColumns(JsonView(nestedRecords), ctx).error == "unsupported column type");
     return 0;
 }